@@ -0,0 +1,160 @@
+/**
+ * @file casim.h
+ * @author David Kedra, xkedra00
+ * @author Petr Kolařík, xkolar79
+ * @brief C interface of the embeddable simulation library (libcasim)
+ * 
+ * The library runs the whole model without any display, so that it can be
+ * linked into other tools and stepped in-process. Cells are stored as the
+ * CASIM_CELL_* bit states in one row-major buffer of width x width bytes.
+ * All the simulations share the global SIMLIB random generator.
+ * 
+ * IMS Project - Cellular automata
+ * VUT FIT Brno, 2022/2023 
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CASIM_UPDATE_SCAN 0     ///< Moves to the neighbouring cells are written during the rules scan
+#define CASIM_UPDATE_INTENT 1   ///< Moves are collected as intents and settled after the scan (scan order independent)
+
+#define CASIM_CELL_NONE 0       ///< Cell state bits of the cell buffer (see casim_cells)
+#define CASIM_CELL_TISSUE 1
+#define CASIM_CELL_TOXIC 2
+#define CASIM_CELL_FLUORIDE 4
+#define CASIM_CELL_BLOOD 8
+#define CASIM_CELL_STOMACH 16
+#define CASIM_CELL_OXYGEN 32
+#define CASIM_CELL_WATER 64
+#define CASIM_CELL_WEAK 128
+
+#define CASIM_HEAT_TOXIC_EXPOSURE 0 ///< Heatmap of iterations each tissue and blood cell has been adjacent to a toxic cell
+#define CASIM_HEAT_WEAK_PRESENCE 1  ///< Heatmap of iterations each cell has been weak
+
+/**
+ * Opaque simulation handle
+ */
+typedef struct casim casim_t;
+
+/**
+ * Parameters of the simulated person and the eaten toothpaste
+ */
+typedef struct{
+    float weight;               ///< Person weight in kg
+    unsigned ppm;               ///< PPM toothpaste units
+    unsigned toothpasteVolume;  ///< Toothpaste volume eaten in ml
+    float fullness;             ///< Approximate food stomach fullness percentile
+    unsigned updateMode;        ///< CASIM_UPDATE_SCAN or CASIM_UPDATE_INTENT
+    unsigned heatmaps;          ///< Nonzero to accumulate the heatmap layers
+}casim_params_t;
+
+/**
+ * Cell counters of the current matrix and metrics derived from them
+ */
+typedef struct{
+    unsigned iters;             ///< Number of finished iterations
+    unsigned minutes;           ///< Simulated time in minutes
+    unsigned fluoride;          ///< Counter of fluoride cells
+    unsigned oxygen;            ///< Counter of oxygen cells
+    unsigned blood;             ///< Counter of all blood cells (blood + oxygen + weak)
+    unsigned toxic;             ///< Counter of toxic cells
+    unsigned weak;              ///< Counter of weak cells
+    double oxygenPerc;          ///< Oxygen in % of blood volume
+    double oxygenSaturation;    ///< Oxygen saturation in %
+    double fluorideInBlood;     ///< Fluoride in blood in mg F/kg body weight
+}casim_stats_t;
+
+/**
+ * @brief Create a simulation and place the initial cells
+ * @param params Parameters of the person and the toothpaste
+ * @param seed Seed of the SIMLIB random generator
+ * @return casim_t* New simulation (free with casim_destroy)
+ */
+casim_t *casim_create(const casim_params_t *params, long seed);
+
+/**
+ * @brief Free a simulation
+ * @param sim Simulation created by casim_create
+ */
+void casim_destroy(casim_t *sim);
+
+/**
+ * @brief Run n iterations of the automata driven by the SIMLIB calendar (one iteration per time unit).
+ * The calendar is global, so only one simulation can be stepped at a time.
+ * @param sim Simulation
+ * @param n Number of iterations
+ */
+void casim_step(casim_t *sim, unsigned n);
+
+/**
+ * @brief Read the counters and the derived metrics of the current matrix
+ * @param sim Simulation
+ * @param stats Output statistics
+ */
+void casim_stats(const casim_t *sim, casim_stats_t *stats);
+
+/**
+ * @brief Get a read-only view of the current cell buffer, valid until the next casim_step
+ * @param sim Simulation
+ * @param width Output number of cells in each row (may be NULL)
+ * @return const uint8_t* Row-major buffer of width x width CASIM_CELL_* states
+ */
+const uint8_t *casim_cells(const casim_t *sim, unsigned *width);
+
+/**
+ * @brief Get a read-only view of a heatmap layer
+ * @param sim Simulation
+ * @param layer CASIM_HEAT_TOXIC_EXPOSURE or CASIM_HEAT_WEAK_PRESENCE
+ * @return const uint32_t* Row-major buffer of width x width counters (NULL if the heatmaps are disabled)
+ */
+const uint32_t *casim_heatmap(const casim_t *sim, unsigned layer);
+
+/**
+ * @brief Dump a heatmap layer into a binary file.
+ * The file starts with the "CAHM" magic followed by the uint32_t width, iteration and layer,
+ * then width x width uint32_t counters in a row-major order (native byte order)
+ * @param sim Simulation
+ * @param layer CASIM_HEAT_TOXIC_EXPOSURE or CASIM_HEAT_WEAK_PRESENCE
+ * @param path Output file path
+ * @return int 0 on success, -1 on failure or with the heatmaps disabled
+ */
+int casim_dump_heatmap(const casim_t *sim, unsigned layer, const char *path);
+
+/**
+ * @brief Schedule an action in the simulation calendar, it fires before the iteration at the same time
+ * @param sim Simulation
+ * @param iter Iteration of the first activation (ITERS_PER_MINUTE = 12 iterations per minute)
+ * @param period Iterations between the activations (0 for a single one)
+ * @param action Action to be done
+ * @param data User data passed to the action
+ */
+void casim_schedule(casim_t *sim, unsigned iter, unsigned period, void (*action)(casim_t *sim, void *data), void *data);
+
+/**
+ * @brief Schedule another dose of the toothpaste
+ * @param sim Simulation
+ * @param iter Iteration of the dose
+ * @param volume Toothpaste volume in ml
+ */
+void casim_schedule_dose(casim_t *sim, unsigned iter, unsigned volume);
+
+/**
+ * @brief Dump the current cell matrix into a binary snapshot file.
+ * Only the cells are written, so the run cannot be resumed from the snapshot.
+ * The file starts with the "CASN" magic followed by the uint32_t width and iteration,
+ * then width x width CType bytes in a row-major order
+ * @param sim Simulation
+ * @param path Output file path
+ * @return int 0 on success, -1 on failure
+ */
+int casim_dump_cells(const casim_t *sim, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
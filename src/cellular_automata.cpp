@@ -12,8 +12,10 @@
 #include <iostream>
 #include <cmath>
 #include <tuple>
+#include <algorithm>
 
 #include "cellular_automata.hpp"
+#include "kernels.hpp"
 
 Rules::Rules(){
     // Static rules definitions
@@ -137,6 +139,14 @@ Rules::Rules(){
         }, CType::oxygen},
     };
     rules = temp;
+
+    // Rules transposed for matching them all at once, padding rules expect 'none' and never match
+    lanes = (rules.size() + RULE_LANES - 1) / RULE_LANES * RULE_LANES;
+    exp.assign(9 * lanes, CType::none);
+    for(unsigned r = 0; r < rules.size(); r++){
+        for(unsigned k = 0; k < 9; k++)
+            exp[k * lanes + r] = rules[r].exp[k / 3][k % 3];
+    }
 }
 
 tuple <uint8_t, uint8_t, uint8_t>getStateColor(CType cType){
@@ -164,37 +174,59 @@ tuple <uint8_t, uint8_t, uint8_t>getStateColor(CType cType){
 }
 
 
+/**
+ * splitmix64 finalizer, mixes all the input bits into the output
+ */
+static uint64_t mix64(uint64_t h){
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
 unsigned getCellCoord(int val){
     return val < 0? 0: (val >= N_WIDTH? N_WIDTH - 1: val);
 }
 
 CA::CA():
-        curr(N_WIDTH, vector<CType>(N_WIDTH)),
-        temp(N_WIDTH, vector<CType>(N_WIDTH)){
+        mode(UpdateMode::scanUpdate), seed(0), heatmaps(false), epoch(1){
     this->r = new Rules();
 }
 
+CA::~CA(){
+    delete this->r;
+}
+
+void CA::enableIntents(){
+    this->mode = UpdateMode::intentUpdate;
+    this->rowMoves.assign(N_WIDTH, vector<move_t>());
+    this->claimed.assign(N_CELLS, 0);
+}
+
+void CA::enableHeatmaps(){
+    for(auto &layer : this->heat)
+        layer.assign(N_CELLS, 0);
+    this->heatmaps = true;
+}
+
 void CA::applyRulesToTemp(int x, int y){
     int x00 = x - 1; // Cellular matrix top left X coord for the 3x3 rule 
     int y00 = y - 1; // Cellular matrix top left Y coord for the 3x3 rule
 
-    // Compare the rule cells with the matrix cells
-    for(auto & rule : this->r->rules) {
-        if(        (rule.exp[0][0] & this->curr[getCellCoord(0 + y00)][getCellCoord(0 + x00)])
-                && (rule.exp[0][1] & this->curr[getCellCoord(0 + y00)][getCellCoord(1 + x00)])
-                && (rule.exp[0][2] & this->curr[getCellCoord(0 + y00)][getCellCoord(2 + x00)])
-                && (rule.exp[1][0] & this->curr[getCellCoord(1 + y00)][getCellCoord(0 + x00)])
-                && (rule.exp[1][1] & this->curr[getCellCoord(1 + y00)][getCellCoord(1 + x00)])
-                && (rule.exp[1][2] & this->curr[getCellCoord(1 + y00)][getCellCoord(2 + x00)])
-                && (rule.exp[2][0] & this->curr[getCellCoord(2 + y00)][getCellCoord(0 + x00)])
-                && (rule.exp[2][1] & this->curr[getCellCoord(2 + y00)][getCellCoord(1 + x00)])
-                && (rule.exp[2][2] & this->curr[getCellCoord(2 + y00)][getCellCoord(2 + x00)])){
-            if(this->temp[y][x] == CType::none)
-                this->temp[y][x] = rule.output;
-            break;
-        }
+    // 3x3 neighbourhood of the center cell
+    uint8_t nb[9];
+    for(int i = 0; i < 3; i++){
+        for(int j = 0; j < 3; j++)
+            nb[i * 3 + j] = this->curr[getCellCoord(i + y00)][getCellCoord(j + x00)];
     }
 
+    // Compare the rule cells with the matrix cells, the first matching rule is applied
+    unsigned match = matchRules(this->r->exp.data(), this->r->lanes, nb);
+    if(match < this->r->rules.size() && this->temp[y][x] == CType::none)
+        this->temp[y][x] = this->r->rules[match].output;
+
+    size_t idx = (size_t)y * N_WIDTH + x; // Row-major index of the center cell
+    unsigned draw = 1;              // Random draws of the center cell, draw 0 is used by the excretion
+
     // Check the neighborhood of fluoride and toxic fluoride cells
     if(this->curr[y][x] == CType::fluoride || this->curr[y][x] == CType::toxic){
         int cntWater = 0;
@@ -205,7 +237,7 @@ void CA::applyRulesToTemp(int x, int y){
 
         for(int i = 0; i < 3; i++){
             for(int j = 0; j < 3; j++){
-                CType point = this->curr[getCellCoord(i + y00)][getCellCoord(j + x00)];
+                CType point = (CType)nb[i * 3 + j];
                 
                 if(point == CType::water)
                     cntWater++;
@@ -226,32 +258,30 @@ void CA::applyRulesToTemp(int x, int y){
         }
         // Rule: Move a fluoride left (if there is not already a fluoride and 2+ hydrofluoric is around)
         else if(this->curr[y][x] == CType::fluoride && cntWater > 1
-                && this->temp[y][x] != CType::fluoride && this->temp[y][getCellCoord(x - 1)] != CType::fluoride){
+                && this->canMove(x, y, getCellCoord(x - 1), y, CType::fluoride)){
             
             double moveLeftProb = 0.5; // Probability to move a fluoride left along water (hydrofluoric acid)
-            if(simlib3::Random() < moveLeftProb){
-                this->temp[y][x] = this->temp[y][getCellCoord(x - 1)];
-                this->temp[y][getCellCoord(x - 1)] = CType::fluoride;
-            }
+            if(this->random(idx, draw++) < moveLeftProb)
+                this->move(x, y, getCellCoord(x - 1), y, CType::fluoride, CType::none);
         }
         // Rules for a toxic fluoride in tissues 
         else if(this->curr[y][x] == CType::toxic){
             // Rule: If there is a blood around or a toxic still is in a vein, randomly move
             if(cntBlood > 0 || (cntBlood == 0 && cntWeak > 0)){
                 // Single cell size step left, right, up or down
-                int nx = getCellCoord(x + lround(simlib3::Random() * 2 - 1));
-                int ny = getCellCoord(y + lround(simlib3::Random() * 2 - 1));
+                int nx = getCellCoord(x + lround(this->random(idx, draw++) * 2 - 1));
+                int ny = getCellCoord(y + lround(this->random(idx, draw++) * 2 - 1));
 
                 int tries = 0; // Number of tries to find a blood
                 // Move to a blood cell
                 while(this->curr[ny][nx] != CType::blood){
-                    nx = getCellCoord(x + lround(simlib3::Random() * 2 - 1));
-                    ny = getCellCoord(y + lround(simlib3::Random() * 2 - 1));
+                    nx = getCellCoord(x + lround(this->random(idx, draw++) * 2 - 1));
+                    ny = getCellCoord(y + lround(this->random(idx, draw++) * 2 - 1));
 
                     // Every (1/0.1)th try the toxic cells chooses random x and y +- 3 up or down
-                    if(simlib3::Random() < 0.05){
-                        nx = getCellCoord(lround(simlib3::Random() * N_WIDTH / 2 - 1));
-                        ny = getCellCoord(y + lround(simlib3::Random() * 6 - 3));
+                    if(this->random(idx, draw++) < 0.05){
+                        nx = getCellCoord(lround(this->random(idx, draw++) * N_WIDTH / 2 - 1));
+                        ny = getCellCoord(y + lround(this->random(idx, draw++) * 6 - 3));
                     }
                     if(tries >= 9)
                         break;
@@ -260,17 +290,14 @@ void CA::applyRulesToTemp(int x, int y){
                 }
                 // Randomly move a toxic cell
                 static const float probToMove = 0.4;
-                if(simlib3::Random() < probToMove && this->temp[y][x] != CType::toxic && this->temp[ny][nx] != CType::toxic){
+                if(this->random(idx, draw++) < probToMove && this->canMove(x, y, nx, ny, CType::toxic)){
                     // Last location replace with blood if there are not lots of tissues around
-                    this->temp[y][x] = cntBlood + cntOxygen + cntWeak >= cntTissue - 2? CType::blood: CType::tissue;
-                    this->temp[ny][nx] = CType::toxic;
+                    this->move(x, y, nx, ny, CType::toxic, cntBlood + cntOxygen + cntWeak >= cntTissue - 2? CType::blood: CType::tissue);
                 }
             }
             // Rule: Move toxic cells left (do not overwrite another toxic)
-            else if(this->temp[y][x] != CType::toxic && this->temp[y][getCellCoord(x-1)] != CType::toxic){
-                CType last = this->temp[y][getCellCoord(x-1)];
-                this->temp[y][getCellCoord(x-1)] = CType::toxic;
-                this->temp[y][x] = last;
+            else if(this->canMove(x, y, getCellCoord(x-1), y, CType::toxic)){
+                this->move(x, y, getCellCoord(x-1), y, CType::toxic, CType::none);
             }
         }
     }
@@ -279,6 +306,83 @@ void CA::applyRulesToTemp(int x, int y){
     if(this->temp[y][x] == CType::none){
         this->temp[y][x] = this->curr[y][x];
     }
+
+    if(this->heatmaps){
+        // A tissue or blood cell is exposed if any cell of its neighbourhood is toxic (counted once per iteration)
+        if(this->curr[y][x] & (CType::tissue | CType::blood | CType::oxygen | CType::weak)){
+            for(int k = 0; k < 9; k++){
+                if(nb[k] == CType::toxic){
+                    this->heat[HeatLayer::toxicExposure][idx]++;
+                    break;
+                }
+            }
+        }
+        if(this->curr[y][x] == CType::weak)
+            this->heat[HeatLayer::weakPresence][idx]++;
+    }
+}
+
+double CA::random(size_t idx, unsigned draw){
+    if(this->mode == UpdateMode::scanUpdate)
+        return simlib3::Random();
+
+    // Counter-based random number of the cell, independent of the scan order
+    uint64_t h = mix64(mix64(mix64(mix64(this->seed) ^ this->epoch) ^ idx) ^ draw);
+    return (h >> 11) * (1.0 / 9007199254740992.0); // 53 bits to [0, 1)
+}
+
+bool CA::canMove(int sx, int sy, int dx, int dy, CType moved){
+    if(this->mode == UpdateMode::intentUpdate)
+        return true;
+    return this->temp[sy][sx] != moved && this->temp[dy][dx] != moved;
+}
+
+void CA::move(int sx, int sy, int dx, int dy, CType moved, CType vacated){
+    size_t src = (size_t)sy * N_WIDTH + sx;
+    size_t dst = (size_t)dy * N_WIDTH + dx;
+
+    // A cell staying in place or the direct update only touches the 'temp' matrix
+    if(this->mode == UpdateMode::scanUpdate || src == dst){
+        this->temp.cells[src] = vacated == CType::none? this->temp.cells[dst]: vacated;
+        this->temp.cells[dst] = moved;
+        return;
+    }
+
+    // Priority hashed from the seed, the pass and the move
+    uint64_t h = mix64(mix64(mix64(this->seed ^ mix64(this->epoch)) ^ src) ^ dst);
+
+    // Each row emits into its own buffer, so the rows never write to a shared state
+    this->rowMoves[sy].push_back({src, dst, moved, vacated, (uint32_t)(h >> 32)});
+}
+
+void CA::resolveMoves(){
+    for(auto &row : this->rowMoves){
+        this->moves.insert(this->moves.end(), row.begin(), row.end());
+        row.clear();
+    }
+
+    // Higher priority first, the cell indexes make the order total
+    sort(this->moves.begin(), this->moves.end(), [](const move_t &a, const move_t &b){
+        if(a.prio != b.prio)
+            return a.prio > b.prio;
+        return a.src != b.src? a.src < b.src: a.dst < b.dst;
+    });
+
+    for(auto &m : this->moves){
+        // Each cell takes part in one move at most
+        if(this->claimed[m.src] == this->epoch || this->claimed[m.dst] == this->epoch)
+            continue;
+        // Do not overwrite another cell of the same state
+        if(this->temp.cells[m.dst] == m.moved)
+            continue;
+
+        this->temp.cells[m.src] = m.vacated == CType::none? this->temp.cells[m.dst]: m.vacated;
+        this->temp.cells[m.dst] = m.moved;
+        this->claimed[m.src] = this->claimed[m.dst] = this->epoch;
+    }
+
+    this->moves.clear();
+    this->epoch++;
 }
 
 void CA::randomMove(CType moveType, float fullness){
@@ -295,7 +399,7 @@ void CA::randomMove(CType moveType, float fullness){
                 this->temp[i][j] = this->curr[i][j];
 
             static const float initFullFactor = 0.8; // Fluoride absorbs in a speed adjusted by this coeficient
-            static float probToMove = 1.0 - fullness * initFullFactor; // Probability to move: (1.0 for empty, 1-initFullFactor for full)
+            const float probToMove = 1.0 - fullness * initFullFactor; // Probability to move: (1.0 for empty, 1-initFullFactor for full)
             
             // Conditionally move the current cell
             if(this->curr[i][j] == moveType && simlib3::Random() <= probToMove){
@@ -315,5 +419,5 @@ void CA::randomMove(CType moveType, float fullness){
         }
     }
     // Reassign temp to a current cellular matrix
-    this->curr = this->temp;
+    copyCells(this->curr.cells.data(), this->temp.cells.data(), N_CELLS);
 }
\ No newline at end of file
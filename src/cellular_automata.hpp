@@ -15,8 +15,13 @@
 #include <tuple>
 
 #define SIZE 700    ///< Size of the window in pixels
+#ifndef N_WIDTH
 #define N_WIDTH 100 ///< Size of the cellurar automata (Number of cells in each row)
+#endif
+#define N_CELLS ((size_t)N_WIDTH * N_WIDTH) ///< Number of all the cells, indexes of the cells are size_t so that they do not overflow
+#define TILE_SIZE 16 ///< Cells in each row of a counted tile
 #define MAX_STEP 2  ///< Maximal cell step for a random movement
+#define N_HEAT_LAYERS 2 ///< Number of the cumulative heatmap layers
 
 using namespace std;
 
@@ -25,6 +30,19 @@ using namespace std;
  */
 enum CType: uint8_t {none=0, tissue=1, toxic=2, fluoride=4, blood=8, stomach=16, oxygen=32, water=64, weak=128, any=255};
 
+/**
+ * Update modes of the fluoride and toxic moves to the neighbouring cells
+ */
+enum UpdateMode: uint8_t {scanUpdate=0, intentUpdate=1};
+
+/**
+ * Cumulative heatmap layers, accumulated per cell over the iterations
+ */
+enum HeatLayer: uint8_t {
+    toxicExposure=0,    ///< Number of iterations a tissue or blood (blood, oxygen, weak) cell has been adjacent to a toxic cell
+    weakPresence=1      ///< Number of iterations a cell has been weak
+};
+
 /**
  * Rule with an expected input 3x3 matrix and an output cell
  */
@@ -33,6 +51,17 @@ typedef struct{
     CType output;
 }rule_t;
 
+/**
+ * Move intent of a cell to a neighbouring cell, settled after the rules pass
+ */
+typedef struct{
+    size_t src;     ///< Row-major index of the moving cell
+    size_t dst;     ///< Row-major index of the target cell
+    CType moved;    ///< State placed at the target cell
+    CType vacated;  ///< State left at the source cell (none to swap with the target)
+    uint32_t prio;  ///< Hashed priority to settle conflicts
+}move_t;
+
 /**
  * Get a bounding save coordination with respect to a automata size.
  * Outer points are converted to a bounding (0 or N_WIDTH - 1)
@@ -47,12 +76,32 @@ unsigned getCellCoord(int val);
  */
 tuple <uint8_t, uint8_t, uint8_t>getStateColor(CType cType);
 
+/**
+ * Cellular matrix stored as one contiguous row-major buffer of N_WIDTH x N_WIDTH cells
+ */
+class Grid{
+    public:
+        vector<CType> cells; ///< Row-major cell states
+
+        Grid(CType cType = CType::none): cells(N_CELLS, cType){}
+
+        /**
+         * Get a matrix row, so that the cells can be addressed as grid[y][x]
+         * @param y Y matrix coordinate
+         * @return CType* First cell of the row
+         */
+        CType *operator[](unsigned y){ return &cells[(size_t)y * N_WIDTH]; }
+        const CType *operator[](unsigned y) const { return &cells[(size_t)y * N_WIDTH]; }
+};
+
 /**
  * Class with all the cellular rules
  */
 class Rules{
     public:
         vector<rule_t> rules;
+        vector<uint8_t> exp; ///< Expected rule cells by the 3x3 position for matchRules: exp[k * lanes + rule]
+        unsigned lanes;      ///< Number of the rules padded with never matching ones
         Rules();
 };
 
@@ -61,11 +110,20 @@ class Rules{
  */
 class CA{
     public:
-        vector<vector<CType>> curr; ///< Current displayed matrix with cells
-        vector<vector<CType>> temp; ///< Next displayed matrix for applying rules
+        Grid curr; ///< Current displayed matrix with cells
+        Grid temp; ///< Next displayed matrix for applying rules
         Rules *r; ///< Rules
+        UpdateMode mode; ///< Moves written directly during the scan or as intents settled afterwards (set by enableIntents)
+        uint64_t seed; ///< Seed of the counter-based random numbers and priorities in the intentUpdate mode
+        bool heatmaps; ///< Accumulate the heatmap layers during the rules pass
+        vector<uint32_t> heat[N_HEAT_LAYERS]; ///< Row-major heatmap layers (empty until enabled)
 
         CA();
+        ~CA();
+
+        // Owns the rules, so it cannot be copied
+        CA(const CA &) = delete;
+        CA &operator=(const CA &) = delete;
         
         /**
          * Go through all the rulles for a specific center cell.
@@ -75,10 +133,60 @@ class CA{
          */
         void applyRulesToTemp(int x, int y);
 
+        /**
+         * Switch to the intentUpdate mode and allocate its move buffers
+         */
+        void enableIntents();
+
+        /**
+         * Allocate the heatmap layers and start accumulating them in applyRulesToTemp
+         */
+        void enableHeatmaps();
+
+        /**
+         * Get a random number of a cell for the current pass.
+         * The scanUpdate mode draws from the SIMLIB generator, the intentUpdate mode hashes
+         * the seed, the pass, the cell and the draw, so the result does not depend on the scan order.
+         * @param idx Row-major index of the cell
+         * @param draw Index of the draw of the cell in this pass
+         * @return double Random number in [0, 1)
+         */
+        double random(size_t idx, unsigned draw);
+
+        /**
+         * Settle the move intents collected by applyRulesToTemp in the intentUpdate mode.
+         * Each cell takes part in at most one move, conflicts are won by the higher hashed priority,
+         * so the result does not depend on the scan order.
+         */
+        void resolveMoves();
+
         /**
          * Randomly move all the 'moveType' cells around their locations
          * @param moveType Cell state to be moved
          * @param fullness Food stomach fullness to affecting the tendency to move 
          */
         void randomMove(CType moveType, float fullness);
+
+    private:
+        vector<vector<move_t>> rowMoves; ///< Move intents of the current pass emitted by each row (empty until enabled)
+        vector<move_t> moves;       ///< Move intents of all the rows being settled
+        vector<uint32_t> claimed;   ///< Epoch in which a cell last took part in a settled move (empty until enabled)
+        uint32_t epoch;             ///< Counter of the settled passes, seeds the priorities
+
+        /**
+         * Check that neither the source nor the target cell already holds the moved state.
+         * Intents are checked when they are settled instead.
+         */
+        bool canMove(int sx, int sy, int dx, int dy, CType moved);
+
+        /**
+         * Move a cell in the 'temp' matrix, or emit a move intent in the intentUpdate mode
+         * @param sx Source X coordinate
+         * @param sy Source Y coordinate
+         * @param dx Target X coordinate
+         * @param dy Target Y coordinate
+         * @param moved State placed at the target cell
+         * @param vacated State left at the source cell (none to swap with the target)
+         */
+        void move(int sx, int sy, int dx, int dy, CType moved, CType vacated);
 };
\ No newline at end of file
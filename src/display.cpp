@@ -0,0 +1,192 @@
+/**
+ * @file display.cpp
+ * @author David Kedra, xkedra00
+ * @author Petr Kolařík, xkolar79
+ * @brief OpenCV display functions
+ * 
+ * IMS Project - Cellular automata
+ * VUT FIT Brno, 2022/2023 
+ */
+
+#include <cstring>
+
+#include "display.hpp"
+#include "simulation.hpp"
+#include "kernels.hpp"
+
+Viewer::Viewer():
+        pixelsPerCell(1), cellsPerPixel(1), x0(0), y0(0){
+    for(unsigned c = 0; c < 256; c++){
+        tuple <uint8_t, uint8_t, uint8_t>color = getStateColor((CType)c);
+        this->palette[c][0] = get<0>(color);
+        this->palette[c][1] = get<1>(color);
+        this->palette[c][2] = get<2>(color);
+    }
+    this->key('0');
+}
+
+void Viewer::update(const frame_t &frame){
+    if(frame.tiles.empty())
+        return;
+
+    // Level 0 are the tiles counted by the simulation, every next level sums 2x2 tiles
+    this->mips.resize(1);
+    this->mipWidth.assign(1, N_TILES);
+    this->mips[0] = frame.tiles;
+
+    while(this->mipWidth.back() > 1){
+        const vector<uint32_t> &lower = this->mips.back();
+        unsigned lw = this->mipWidth.back();
+        unsigned w = (lw + 1) / 2;
+        vector<uint32_t> level(w * w * 8, 0);
+
+        for(unsigned ty = 0; ty < lw; ty++){
+            for(unsigned tx = 0; tx < lw; tx++){
+                const uint32_t *src = &lower[(ty * lw + tx) * 8];
+                uint32_t *dst = &level[((ty / 2) * w + tx / 2) * 8];
+                for(unsigned b = 0; b < 8; b++)
+                    dst[b] += src[b];
+            }
+        }
+        this->mips.push_back(level);
+        this->mipWidth.push_back(w);
+    }
+}
+
+void Viewer::render(Mat &plane, const frame_t &frame){
+    const Grid &cells = frame.cells;
+    plane.setTo(Scalar(0,0,0));
+
+    // Visible part of the matrix in pixels
+    int width = min(SIZE, (N_WIDTH - this->x0) * (int)this->pixelsPerCell / (int)this->cellsPerPixel);
+    int height = min(SIZE, (N_WIDTH - this->y0) * (int)this->pixelsPerCell / (int)this->cellsPerPixel);
+
+    if(this->cellsPerPixel == 1){
+        // Only the visible cells at full resolution, each pixel row rendered once and repeated
+        unsigned cols = (width + this->pixelsPerCell - 1) / this->pixelsPerCell;
+        vector<uint8_t> row(cols * this->pixelsPerCell * 3);
+
+        for(int py = 0; py < height; py += this->pixelsPerCell){
+            paintCells(&cells[this->y0 + py / this->pixelsPerCell][this->x0], cols, this->palette, this->pixelsPerCell, row.data());
+            for(int i = py; i < min(height, py + (int)this->pixelsPerCell); i++)
+                memcpy(plane.ptr<uint8_t>(i), row.data(), width * 3);
+        }
+    }
+    else if(this->cellsPerPixel < TILE_SIZE || this->mips.empty()){
+        // Nearest cell of each pixel
+        vector<CType> row(width);
+
+        for(int py = 0; py < height; py++){
+            const CType *src = cells[this->y0 + py * this->cellsPerPixel];
+            for(int px = 0; px < width; px++)
+                row[px] = src[this->x0 + px * this->cellsPerPixel];
+            paintCells(row.data(), width, this->palette, 1, plane.ptr<uint8_t>(py));
+        }
+    }
+    else{
+        // Each pixel covers a whole tile of a mipmap level, its color is mixed from the tile counts
+        unsigned level = 0;
+        while((unsigned)(TILE_SIZE << level) < this->cellsPerPixel)
+            level++;
+        level = min<unsigned>(level, this->mips.size() - 1);
+
+        const vector<uint32_t> &mip = this->mips[level];
+        unsigned w = this->mipWidth[level];
+        unsigned tile = TILE_SIZE << level;
+
+        for(int py = 0; py < height; py++){
+            uint8_t *dst = plane.ptr<uint8_t>(py);
+            unsigned ty = (this->y0 + py * this->cellsPerPixel) / tile;
+
+            for(int px = 0; px < width; px++){
+                unsigned tx = (this->x0 + px * this->cellsPerPixel) / tile;
+                const uint32_t *cnt = &mip[(ty * w + tx) * 8];
+
+                uint64_t sum[3] = {0, 0, 0};
+                uint64_t total = 0;
+                for(unsigned b = 0; b < 8; b++){
+                    for(unsigned c = 0; c < 3; c++)
+                        sum[c] += (uint64_t)cnt[b] * this->palette[1 << b][c];
+                    total += cnt[b];
+                }
+                for(unsigned c = 0; c < 3; c++)
+                    dst[px * 3 + c] = total? sum[c] / total: this->palette[CType::none][c];
+            }
+        }
+    }
+}
+
+bool Viewer::key(int key){
+    int step = max(1, this->viewCells() / 8); // Pan by an eighth of the view
+
+    switch(key){
+        case '+': case '=':
+            this->zoom(true);
+            break;
+        case '-':
+            this->zoom(false);
+            break;
+        case 'w':
+            this->y0 -= step;
+            break;
+        case 's':
+            this->y0 += step;
+            break;
+        case 'a':
+            this->x0 -= step;
+            break;
+        case 'd':
+            this->x0 += step;
+            break;
+        case '0':
+            // Fit the whole matrix into the window
+            this->pixelsPerCell = max(1, SIZE / N_WIDTH);
+            this->cellsPerPixel = 1;
+            while(N_WIDTH > SIZE * (int)this->cellsPerPixel)
+                this->cellsPerPixel *= 2;
+            this->x0 = this->y0 = 0;
+            break;
+        default:
+            return false;
+    }
+    this->clamp();
+    return true;
+}
+
+void Viewer::zoom(bool in){
+    int center = this->viewCells() / 2;
+    int cx = this->x0 + center;
+    int cy = this->y0 + center;
+
+    if(in){
+        if(this->cellsPerPixel > 1)
+            this->cellsPerPixel /= 2;
+        else if(this->pixelsPerCell * 2 <= SIZE)
+            this->pixelsPerCell *= 2;
+    }
+    else{
+        if(this->pixelsPerCell > 1)
+            this->pixelsPerCell /= 2;
+        else if(N_WIDTH > SIZE * (int)this->cellsPerPixel)
+            this->cellsPerPixel *= 2;
+    }
+
+    center = this->viewCells() / 2;
+    this->x0 = cx - center;
+    this->y0 = cy - center;
+}
+
+void Viewer::clamp(){
+    int maxOrigin = max(0, N_WIDTH - this->viewCells());
+    this->x0 = min(max(this->x0, 0), maxOrigin);
+    this->y0 = min(max(this->y0, 0), maxOrigin);
+}
+
+bool writeHeatmapPng(const vector<uint32_t> &heat, const string &path){
+    Mat image(N_WIDTH, N_WIDTH, CV_16UC1);
+    uint16_t *pixels = image.ptr<uint16_t>();
+
+    for(size_t i = 0; i < heat.size(); i++)
+        pixels[i] = heat[i] > UINT16_MAX? UINT16_MAX: heat[i];
+    return imwrite(path, image);
+}
@@ -0,0 +1,85 @@
+/**
+ * @file display.hpp
+ * @author David Kedra, xkedra00
+ * @author Petr Kolařík, xkolar79
+ * @brief Declarations of the OpenCV display functions
+ * 
+ * IMS Project - Cellular automata
+ * VUT FIT Brno, 2022/2023 
+ */
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/highgui.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "cellular_automata.hpp"
+#include "frame_buffer.hpp"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Level-of-detail viewer of the cellular matrix with zoom and pan.
+ * Zoomed-in views render only the visible cells, zoomed-out views sample the cells or,
+ * once a pixel covers a whole tile, mix the colors from the tile count mipmaps.
+ */
+class Viewer{
+    public:
+        Viewer();
+
+        /**
+         * Rebuild the mipmaps from the tile counts of a new frame
+         * @param frame Published frame
+         */
+        void update(const frame_t &frame);
+
+        /**
+         * Render the current view of a frame
+         * @param plane Canvas plane window to draw at (SIZE x SIZE, 8-bit BGR)
+         * @param frame Frame passed to the last update()
+         */
+        void render(Mat &plane, const frame_t &frame);
+
+        /**
+         * Handle a navigation key: + and - zoom, w a s d pan, 0 resets the view
+         * @param key Key code from waitKey
+         * @return bool True if the key changed the view
+         */
+        bool key(int key);
+
+    private:
+        uint8_t palette[256][3];            ///< BGR colors of all the states
+        vector<vector<uint32_t>> mips;      ///< Tile counts, level l has tiles of TILE_SIZE << l cells
+        vector<unsigned> mipWidth;          ///< Number of tiles in each row of a level
+        unsigned pixelsPerCell;             ///< Zoomed-in scale (1 when zoomed-out)
+        unsigned cellsPerPixel;             ///< Zoomed-out scale, a power of two (1 when zoomed-in)
+        int x0;                             ///< X coordinate of the top left visible cell
+        int y0;                             ///< Y coordinate of the top left visible cell
+
+        /**
+         * Number of the cells visible in each row of the window
+         */
+        int viewCells() const { return SIZE * this->cellsPerPixel / this->pixelsPerCell; }
+
+        /**
+         * Zoom in or out, keeping the center of the view
+         * @param in True to zoom in
+         */
+        void zoom(bool in);
+
+        /**
+         * Keep the view inside the matrix
+         */
+        void clamp();
+};
+
+/**
+ * @brief Write a heatmap layer as a 16-bit grayscale PNG (counters are saturated to 65535)
+ * @param heat Row-major N_WIDTH x N_WIDTH heatmap counters
+ * @param path Output file path
+ * @return bool True on success
+ */
+bool writeHeatmapPng(const vector<uint32_t> &heat, const string &path);
@@ -0,0 +1,33 @@
+/**
+ * @file frame_buffer.cpp
+ * @author David Kedra, xkedra00
+ * @author Petr Kolařík, xkolar79
+ * @brief Lock-free triple buffer between the simulation and the display
+ * 
+ * IMS Project - Cellular automata
+ * VUT FIT Brno, 2022/2023 
+ */
+
+#include "frame_buffer.hpp"
+
+FrameBuffer::FrameBuffer():
+        middle(1), backIdx(0), frontIdx(2){
+    for(auto &frame : this->frames)
+        frame.iters = 0;
+}
+
+void FrameBuffer::publish(){
+    // Swap the back frame with the middle one and mark it as unread
+    uint8_t last = this->middle.exchange(this->backIdx | FRESH, memory_order_acq_rel);
+    this->backIdx = last & ~FRESH;
+}
+
+bool FrameBuffer::acquire(){
+    if(!(this->middle.load(memory_order_relaxed) & FRESH))
+        return false;
+
+    // Swap the front frame with the middle one, the read frame is not fresh anymore
+    uint8_t last = this->middle.exchange(this->frontIdx, memory_order_acq_rel);
+    this->frontIdx = last & ~FRESH;
+    return true;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file frame_buffer.hpp
+ * @author David Kedra, xkedra00
+ * @author Petr Kolařík, xkolar79
+ * @brief Declarations of the lock-free triple buffer between the simulation and the display
+ * 
+ * IMS Project - Cellular automata
+ * VUT FIT Brno, 2022/2023 
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "cellular_automata.hpp"
+
+using namespace std;
+
+/**
+ * Completed cellular matrix together with its tile counts and the iteration it belongs to
+ */
+typedef struct{
+    Grid cells;     ///< Copy of the current matrix
+    vector<uint32_t> tiles; ///< Copy of the tile cell counts of the matrix
+    unsigned iters; ///< Iteration of the matrix
+}frame_t;
+
+/**
+ * Triple buffer passing the latest frame from a single producer to a single consumer.
+ * The producer fills the back frame, the consumer reads the front frame and the middle
+ * one is exchanged atomically, so neither side ever waits for the other.
+ */
+class FrameBuffer{
+    public:
+        FrameBuffer();
+
+        /**
+         * Frame to be filled by the producer before publish()
+         * @return frame_t& Back frame
+         */
+        frame_t &back(){ return this->frames[this->backIdx]; }
+
+        /**
+         * Producer: hand the filled back frame over to the consumer
+         */
+        void publish();
+
+        /**
+         * Producer: check whether the last published frame has not been taken by the consumer yet
+         * @return bool True if the middle frame is still unread
+         */
+        bool pending() const { return this->middle.load(memory_order_acquire) & FRESH; }
+
+        /**
+         * Consumer: take the latest published frame as the front one, if there is a new one
+         * @return bool True if the front frame has changed
+         */
+        bool acquire();
+
+        /**
+         * Frame to be read by the consumer after acquire()
+         * @return const frame_t& Front frame
+         */
+        const frame_t &front() const { return this->frames[this->frontIdx]; }
+
+    private:
+        static const uint8_t FRESH = 4; ///< Flag of the middle index set when it holds an unread frame
+
+        frame_t frames[3];
+        atomic<uint8_t> middle; ///< Middle frame index (exchanged between the threads) with the FRESH flag
+        uint8_t backIdx;        ///< Back frame index owned by the producer
+        uint8_t frontIdx;       ///< Front frame index owned by the consumer
+};
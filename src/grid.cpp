@@ -10,16 +10,6 @@
 
 #include "grid.hpp"
 
-void drawCell(Mat &plane, unsigned x, unsigned y, CType cType){
-    static unsigned width = SIZE / N_WIDTH;
-    tuple <uint8_t, uint8_t, uint8_t>color = getStateColor(cType);
-
-    rectangle(plane,
-        Point(x * width, y * width),
-        Point(x * width + width, y * width + width),
-        Scalar(get<0>(color), get<1>(color), get<2>(color)), FILLED);
-}
-
 void initCellularMatrix(CA *ca){
     // Background: Left side tissue and veins, Right side stomach
     for(unsigned y = 0; y < N_WIDTH; y++){
@@ -101,14 +91,26 @@ void placeOxygenCells(CA *ca, unsigned *amountBlood, unsigned *amountOxygen){
     }
 }
 
-void placeFluorideCells(CA *ca, unsigned *amountFluoride, float weight, unsigned ppm, unsigned toothpasteVolume, unsigned amountBlood){
+/**
+ * @brief Calculate the number of fluoride cells in an eaten toothpaste
+ * @param weight Human weight in kg
+ * @param ppm Toothpaste ppm number of fluorides
+ * @param toothpasteVolume Volume of toothpaste eaten, in ml
+ * @param amountBlood Number of blood + oxygen cells
+ * @return unsigned Number of fluoride cells
+ */
+static unsigned countFluorideCells(float weight, unsigned ppm, unsigned toothpasteVolume, unsigned amountBlood){
     unsigned volumeBlood = weight * BLOOD_PER_KG * 1000; // Average human blood volume in litres
     // Volume of fluoride expressed as a percentage of blood
     double percFluoride = 1000 * ((ppm * DENSITY_TOOTHPASTE) * (toothpasteVolume / 1000.0)) / DENSITY_FLUORIDE / (1000 * volumeBlood);
     // Calculate a concrete number of fluoride cells to be placed
-    unsigned nFluoride = amountBlood * percFluoride; // Initial max number of fluoride cells
+    return amountBlood * percFluoride;
+}
+
+void placeFluorideCells(CA *ca, unsigned *amountFluoride, float weight, unsigned ppm, unsigned toothpasteVolume, unsigned amountBlood){
+    unsigned nFluoride = countFluorideCells(weight, ppm, toothpasteVolume, amountBlood); // Initial max number of fluoride cells
     // Percentage of fluoride cells relative to a right side area
-    double percFluorideArea = nFluoride / (N_WIDTH * N_WIDTH / 2.0);
+    double percFluorideArea = nFluoride / (N_CELLS / 2.0);
     
     unsigned cellCount = 0; // Meantime number of placed cells
 
@@ -136,3 +138,22 @@ void placeFluorideCells(CA *ca, unsigned *amountFluoride, float weight, unsigned
         }
     }
 }
+
+void placeDoseCells(CA *ca, unsigned *amountFluoride, float weight, unsigned ppm, unsigned toothpasteVolume, unsigned amountBlood){
+    unsigned nFluoride = countFluorideCells(weight, ppm, toothpasteVolume, amountBlood);
+
+    for(unsigned n = 0; n < nFluoride; n++){
+        unsigned y = simlib3::Random() * N_WIDTH;
+        unsigned offset = simlib3::Random() * (N_WIDTH / 2); // X coordinate relative to the right side
+
+        // Find the first stomach cell on a row of the right side, wrapping around it
+        for(unsigned tries = 0; tries < N_WIDTH / 2; tries++){
+            unsigned x = N_WIDTH / 2 + (offset + tries) % (N_WIDTH / 2);
+            if(ca->curr[y][x] == CType::stomach){
+                ca->curr[y][x] = CType::fluoride;
+                (*amountFluoride)++;
+                break;
+            }
+        }
+    }
+}
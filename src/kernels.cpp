@@ -0,0 +1,133 @@
+/**
+ * @file kernels.cpp
+ * @author David Kedra, xkedra00
+ * @author Petr Kolařík, xkolar79
+ * @brief Hot kernels of the step, multiversioned for AVX-512/AVX2
+ * 
+ * IMS Project - Cellular automata
+ * VUT FIT Brno, 2022/2023 
+ */
+
+#include <cstring>
+
+#include "kernels.hpp"
+
+// Compile each kernel for several targets, the variant is resolved at load time by the CPU features
+#if defined(__x86_64__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define KERNEL_CLONES __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+#endif
+#endif
+#ifndef KERNEL_CLONES
+#define KERNEL_CLONES
+#endif
+
+#define COUNT_BLOCK 4096 ///< Cells counted per block, so that all the state passes hit the L1 cache
+
+KERNEL_CLONES
+unsigned matchRules(const uint8_t *exp, unsigned lanes, const uint8_t nb[9]){
+    for(unsigned base = 0; base < lanes; base += RULE_LANES){
+        uint8_t ok[RULE_LANES];
+        for(unsigned r = 0; r < RULE_LANES; r++)
+            ok[r] = 1;
+
+        // All the rules of the block at once, a rule matches if every cell shares a bit with the expected one
+        for(unsigned k = 0; k < 9; k++){
+            const uint8_t *e = exp + k * lanes + base;
+            for(unsigned r = 0; r < RULE_LANES; r++)
+                ok[r] &= (e[r] & nb[k]) != 0;
+        }
+
+        uint32_t mask = 0;
+        for(unsigned r = 0; r < RULE_LANES; r++)
+            mask |= (uint32_t)ok[r] << r;
+        if(mask)
+            return base + __builtin_ctz(mask);
+    }
+    return lanes;
+}
+
+void copyCells(CType *dst, const CType *src, size_t n){
+    // glibc already dispatches memcpy to the AVX2/AVX-512 variants
+    memcpy(dst, src, n * sizeof(CType));
+}
+
+void fillCells(CType *dst, CType cType, size_t n){
+    // glibc already dispatches memset to the AVX2/AVX-512 variants
+    memset(dst, cType, n * sizeof(CType));
+}
+
+KERNEL_CLONES
+void countCells(const CType *cells, size_t n, unsigned counts[8]){
+    const uint8_t *c = reinterpret_cast<const uint8_t *>(cells);
+
+    for(unsigned b = 0; b < 8; b++)
+        counts[b] = 0;
+
+    for(size_t start = 0; start < n; start += COUNT_BLOCK){
+        size_t end = start + COUNT_BLOCK < n? start + COUNT_BLOCK: n;
+
+        // Vectorized compare and sum for each state bit
+        for(unsigned b = 0; b < 8; b++){
+            const uint8_t state = 1 << b;
+            unsigned cnt = 0;
+            for(size_t i = start; i < end; i++)
+                cnt += c[i] == state;
+            counts[b] += cnt;
+        }
+    }
+}
+
+KERNEL_CLONES
+void countTiles(const CType *cells, size_t n, uint32_t *counts){
+    const uint8_t *c = reinterpret_cast<const uint8_t *>(cells);
+    static const uint64_t ones = 0x0101010101010101ULL; // Lowest bit of each byte
+
+    for(size_t start = 0; start < n; start += TILE_SIZE){
+        uint32_t *tile = counts + start / TILE_SIZE * 8;
+
+        // Full tiles are summed 8 cells at once, each state bit is gathered to the lowest bits of the bytes
+        // and the bytes are summed by a multiplication (cells hold single bit states, so a set bit is the state)
+        if(start + TILE_SIZE <= n){
+            uint64_t w[TILE_SIZE / 8];
+            memcpy(w, c + start, TILE_SIZE);
+
+            for(unsigned b = 0; b < 8; b++){
+                uint64_t sum = 0;
+                for(unsigned i = 0; i < TILE_SIZE / 8; i++)
+                    sum += (w[i] >> b) & ones;
+                tile[b] += (sum * ones) >> 56;
+            }
+        }
+        else{
+            for(size_t i = start; i < n; i++){
+                if(c[i] && !(c[i] & (c[i] - 1)))
+                    tile[__builtin_ctz(c[i])]++;
+            }
+        }
+    }
+}
+
+KERNEL_CLONES
+void paintCells(const CType *cells, size_t n, const uint8_t palette[256][3], unsigned width, uint8_t *bgr){
+    for(size_t i = 0; i < n; i++){
+        const uint8_t *color = palette[cells[i]];
+        for(unsigned w = 0; w < width; w++){
+            bgr[0] = color[0];
+            bgr[1] = color[1];
+            bgr[2] = color[2];
+            bgr += 3;
+        }
+    }
+}
+
+const char *kernelTarget(){
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("x86-64-v4"))
+        return "x86-64-v4";
+    if(__builtin_cpu_supports("x86-64-v3"))
+        return "x86-64-v3";
+#endif
+    return "default";
+}
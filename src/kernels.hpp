@@ -0,0 +1,78 @@
+/**
+ * @file kernels.hpp
+ * @author David Kedra, xkedra00
+ * @author Petr Kolařík, xkolar79
+ * @brief Declarations of the hot kernels of the step, multiversioned for AVX-512/AVX2
+ * 
+ * The best variant of each kernel is selected once at startup by the CPU features,
+ * so the binary stays portable.
+ * 
+ * IMS Project - Cellular automata
+ * VUT FIT Brno, 2022/2023 
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "cellular_automata.hpp"
+
+#define RULE_LANES 32 ///< Rules matched at once, the rule count is padded to a multiple of it
+
+/**
+ * @brief Find the first rule matching a 3x3 neighbourhood
+ * @param exp Expected rule cells stored by the neighbourhood position: exp[k * lanes + rule]
+ * @param lanes Number of the padded rules (multiple of RULE_LANES, padding rules never match)
+ * @param nb 3x3 neighbourhood in a row-major order
+ * @return unsigned Index of the first matching rule, or lanes if none matches
+ */
+unsigned matchRules(const uint8_t *exp, unsigned lanes, const uint8_t nb[9]);
+
+/**
+ * @brief Copy n cells
+ * @param dst Destination cells
+ * @param src Source cells
+ * @param n Number of cells
+ */
+void copyCells(CType *dst, const CType *src, size_t n);
+
+/**
+ * @brief Set n cells to a state
+ * @param dst Destination cells
+ * @param cType Cell state
+ * @param n Number of cells
+ */
+void fillCells(CType *dst, CType cType, size_t n);
+
+/**
+ * @brief Count the cells of each single bit state
+ * @param cells Cells to be counted
+ * @param n Number of cells
+ * @param counts Output counters indexed by the state bit (counts[3] for CType::blood)
+ */
+void countCells(const CType *cells, size_t n, unsigned counts[8]);
+
+/**
+ * @brief Count the cells of each single bit state in every TILE_SIZE wide tile of a row
+ * @param cells Row of cells (single bit or none states)
+ * @param n Number of cells
+ * @param counts Counters of the tiles added to: counts[tile * 8 + bit] (the last tile may be partial)
+ */
+void countTiles(const CType *cells, size_t n, uint32_t *counts);
+
+/**
+ * @brief Render a row of cells into BGR pixels using a palette
+ * @param cells Row of cells
+ * @param n Number of cells
+ * @param palette BGR colors of all the 256 states
+ * @param width Pixels per cell
+ * @param bgr Output n * width BGR pixels
+ */
+void paintCells(const CType *cells, size_t n, const uint8_t palette[256][3], unsigned width, uint8_t *bgr);
+
+/**
+ * @brief Get the name of the kernel variant selected for this CPU
+ * @return const char* "x86-64-v4" (AVX-512), "x86-64-v3" (AVX2) or "default"
+ */
+const char *kernelTarget();
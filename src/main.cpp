@@ -2,7 +2,7 @@
  * @file main.cpp
  * @author David Kedra, xkedra00
  * @author Petr Kolařík, xkolar79
- * @brief Main loop
+ * @brief Main loop (display front-end of libcasim)
  * 
  * IMS Project - Cellular automata
  * VUT FIT Brno, 2022/2023 
@@ -18,31 +18,120 @@
 #include <simlib.h>
 #include <getopt.h>
 #include <algorithm> 
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <climits>
 
-#include "cellular_automata.hpp"
-#include "grid.hpp"
+#include "simulation.hpp"
+#include "display.hpp"
+#include "frame_buffer.hpp"
+#include "kernels.hpp"
 
 using namespace cv;
 using namespace std;
 
-#define EXCRETE_MINUTES 120         ///< Average time until the fluoride starts excretion to livers
-#define ITERS_PER_MINUTE 12         ///< How many iterations is approximately 1 minute
+static atomic<bool> running(true);  ///< Simulation thread keeps stepping until the display is closed
+static atomic<bool> paused(false);  ///< Simulation thread is paused by a key press (with fps == 0)
 
+/**
+ * @brief Dump all the heatmap layers of the current iteration (heat_<layer>_<iteration>.png or .bin)
+ * @param sim Simulation with the heatmaps enabled
+ * @param binary Dump in the binary format instead of a 16-bit PNG
+ */
+static void dumpHeatmaps(Simulation *sim, bool binary){
+    static const char *names[N_HEAT_LAYERS] = {"exposure", "weak"};
+
+    for(unsigned layer = 0; layer < N_HEAT_LAYERS; layer++){
+        string path = "heat_" + string(names[layer]) + "_" + to_string(sim->iters) + (binary? ".bin": ".png");
+        bool ok = binary? sim->dumpHeatmap((HeatLayer)layer, path.c_str()): writeHeatmapPng(sim->heatmap((HeatLayer)layer), path);
+        if(!ok)
+            cerr << "Error: Cannot write " << path << endl;
+    }
+}
+
+/**
+ * @brief Print the stats of the current matrix
+ * @param sim Simulation
+ */
+static void printStats(Simulation &sim){
+    casim_stats_t stats = sim.stats();
+    printf("-------------------------------- %3d min -------------------------------\n", stats.minutes);
+    printf("Iteration: %d\n", stats.iters);
+    printf("Oxygen: %.2f %% of blood volume\n", stats.oxygenPerc);
+    printf("Oxygen saturation: %.2f %%\n", stats.oxygenSaturation);
+    printf("Fluoride in blood %.2f mg F/kg body weight\n", stats.fluorideInBlood);
+}
+
+/**
+ * @brief Simulation thread: run the calendar of the simulation and publish the matrices for the display
+ * @param sim Simulation with the scheduled actions
+ * @param buffer Triple buffer shared with the display thread
+ * @param rate Iterations per second (0 for an unthrottled run)
+ */
+static void simulate(Simulation *sim, FrameBuffer *buffer, unsigned rate){
+    chrono::steady_clock::time_point next = chrono::steady_clock::now();
+
+    // Publish the completed matrix, the display picks up the latest one at its own rate.
+    // While the display has not taken the last frame yet, copying another one would be wasted.
+    unsigned published = UINT_MAX; // Iteration of the last published matrix
+    auto publish = [buffer, &published](Simulation &s){
+        if(s.iters == published || buffer->pending())
+            return;
+        frame_t &frame = buffer->back();
+        frame.cells = s.cells();
+        frame.tiles = s.tiles;
+        frame.iters = s.iters;
+        buffer->publish();
+        published = s.iters;
+    };
+    publish(*sim);
+
+    sim->onStep = [&](Simulation &s){
+        publish(s);
+
+        // Throttle the simulation independently of the display, a late iteration does not start a burst
+        if(rate){
+            next = max(next + chrono::nanoseconds(1000000000 / rate), chrono::steady_clock::now());
+            this_thread::sleep_until(next);
+        }
+        while(paused && running){
+            // The paused matrix is published once the display takes the previous one
+            publish(s);
+            this_thread::sleep_for(chrono::milliseconds(10));
+            next = chrono::steady_clock::now();
+        }
+        return (bool)running;
+    };
+
+    // Run until the display is closed
+    while(running)
+        sim->step(UINT_MAX);
+}
 
 int main(int argc, char **argv){
     unsigned fps = 1;                   // FPS 
+    int rate = -1;                      // Simulation iterations per second (0 unthrottled, -1 same as FPS)
     float weight = 40;                  // Person weight in kg
     unsigned ppm = 1500;                // PPM toothpaste units
     unsigned toothpasteVolume = 100;    // Toothpaste volume eaten in ml
     float fullness = 0.25;              // Approximate food stomach fullness percentile
+    unsigned updateMode = CASIM_UPDATE_SCAN; // Moves written during the scan (0) or settled as intents (1)
+    unsigned heatInterval = 0;          // Iterations between the heatmap dumps (0 disables the heatmaps)
+    bool heatBinary = false;            // Heatmaps dumped in the binary format instead of a 16-bit PNG
+    unsigned snapshotMinutes = 0;       // Minutes between the matrix snapshots (0 for no snapshots)
+    vector<unsigned> doseMinutes;       // Minutes of the further toothpaste doses
 
     int c;
     try{
-        while ((c = getopt(argc, argv, "s:w:p:v:f:")) != -1){
+        while ((c = getopt(argc, argv, "s:i:w:p:v:f:m:e:x:c:d:")) != -1){
             switch (c){
                 case 's': // Speed of drawing
                     fps = stoi(optarg);
                     break;
+                case 'i': // Speed of the simulation
+                    rate = stoi(optarg);
+                    break;
                 case 'w': // Weight of a person
                     weight = atof(optarg);
                     break;
@@ -55,6 +144,25 @@ int main(int argc, char **argv){
                 case 'f': // Fullness
                     fullness = atof(optarg);
                     break;
+                case 'm': // Update mode of the moves
+                    updateMode = stoi(optarg);
+                    if(updateMode > CASIM_UPDATE_INTENT)
+                        throw 99;
+                    break;
+                case 'e': // Heatmap dump interval
+                    heatInterval = stoi(optarg);
+                    break;
+                case 'x': // Heatmap dump format
+                    if(string(optarg) != "png" && string(optarg) != "bin")
+                        throw 99;
+                    heatBinary = string(optarg) == "bin";
+                    break;
+                case 'c': // Snapshot interval
+                    snapshotMinutes = stoi(optarg);
+                    break;
+                case 'd': // Another toothpaste dose (can be repeated)
+                    doseMinutes.push_back(stoi(optarg));
+                    break;
 
                 default:
                     throw 99;
@@ -68,135 +176,84 @@ int main(int argc, char **argv){
 
     char window[] = "Grid";                         // Graphic window
     Mat plane = Mat::zeros(SIZE, SIZE, CV_8UC3);    // 2D matrix of (8-bit cells with 3 channels)
-    CA *ca = new CA();                              // Cellular automata object with plane states
-    
-    // Init a random generator
-    simlib3::RandomSeed(time(NULL));
-
-    // Prepare a background (tissues|stomach) a bit jagged on a border
-    // Background: Left side will be tissues and veins, Right side stomach 
-    initCellularMatrix(ca);
-
-    // Left side blood veins placement distribution
-    placeBloodCells(ca);
-
-    // Left side oxygen distribution in veins
-    unsigned amountBlood = 0;   // Total amount of blood with oxygen at the start
-    unsigned amountOxygen = 0;  // Amount of oxygen cells at the start
-    placeOxygenCells(ca, &amountBlood, &amountOxygen);
-
-    // Right side random placement of a certain number of fluorides
-    unsigned amountFluoride = 0; // Amount of fluoride cells at the start
-    placeFluorideCells(ca, &amountFluoride, weight, ppm, toothpasteVolume, amountBlood);
-
-    unsigned iters = 0;         // Counter of iterations
-    unsigned cntFluoride = 0;   // Counter of fluoride cells
-    unsigned cntOxygen = 0;     // Counter of oxygen cells
-    unsigned cntBlood = 0;      // Counter of blood cells    
-    unsigned cntToxic = 0;      // Counter of toxic cells
-    unsigned cntWeak = 0;       // Counter of weak cells
+
+    // By default the simulation keeps the pace of the display as before
+    if(rate < 0)
+        rate = fps? fps: 30;
+
+    casim_params_t params = {weight, ppm, toothpasteVolume, fullness, updateMode, heatInterval > 0};
+    Simulation *sim = new Simulation(params, time(NULL));
+    sim->enableTiles();
 
     printf("------------------------------------------------------------------------\n");
-    printf("%d FPS, %.1f kg, %d ppm, %d ml toothpaste volume, %.1f %% food fullness\n", fps, weight, ppm, toothpasteVolume, fullness * 100);
+    printf("%d FPS, %d it/s, %.1f kg, %d ppm, %d ml toothpaste volume, %.1f %% food fullness, %s kernels\n", fps, rate, weight, ppm, toothpasteVolume, fullness * 100, kernelTarget());
 
-    // Introducing a non-deterministic assumption of eaten amount
-    // Toothpaste volume = volume + (0.00 to 0.33) * volume
-    toothpasteVolume += (int)(toothpasteVolume * simlib3::Random() / 3);
+    // Print the stats every X minutes (X * ITERS_PER_MINUTE) iterations
+    sim->schedule(0, 20 * ITERS_PER_MINUTE, printStats);
 
-    // Main loop
-    while(true){
-        for(unsigned y = 0; y < N_WIDTH; y++){
-            for(unsigned x = 0; x < N_WIDTH; x++){
-                // Draw all cells
-                drawCell(plane, x, y, ca->curr[y][x]);
-
-                // Count cells
-                switch(ca->curr[y][x]){
-                    case(CType::fluoride): cntFluoride++; break;
-                    case(CType::oxygen):   cntOxygen++;   break;
-                    case(CType::blood):    cntBlood++;    break;
-                    case(CType::toxic):    cntToxic++;    break;
-                    case(CType::weak):     cntWeak++;     break;
-                }
-            }
-        }
-        // The blood changes over time, so the total is a sum of these cells
-        cntBlood += cntOxygen + cntWeak;
-
-        // Print the stats every X minutes (X * ITERS_PER_MINUTE) iterations
-        if(!(iters % (20 * ITERS_PER_MINUTE)) || iters == 0){
-            printf("-------------------------------- %3d min -------------------------------\n", iters / ITERS_PER_MINUTE);
-            printf("Iteration: %d\n", iters);
-            printf("Oxygen: %.2f %% of blood volume\n", 100.0 * cntOxygen / cntBlood);
-            printf("Oxygen saturation: %.2f %%\n", min(100.0, 100.0 * cntOxygen / amountOxygen));
-            printf("Fluoride in blood %.2f mg F/kg body weight\n", (1.0 * cntToxic / amountFluoride * (ppm * DENSITY_TOOTHPASTE) * (toothpasteVolume / 1000.0)) / weight);
-        }
+    // Dump the heatmaps every heatInterval iterations
+    if(heatInterval){
+        sim->schedule(heatInterval, heatInterval, [heatBinary](Simulation &s){
+            dumpHeatmaps(&s, heatBinary);
+        });
+    }
 
-        // Random movement of fluoride cells
-        ca->randomMove(CType::fluoride, fullness);
-        
-        // Clear temp matrix with none states
-        ca->temp.assign(N_WIDTH, vector<CType>(N_WIDTH, CType::none));
+    // Dump the matrix every snapshotMinutes minutes
+    if(snapshotMinutes){
+        sim->schedule(snapshotMinutes * ITERS_PER_MINUTE, snapshotMinutes * ITERS_PER_MINUTE, [](Simulation &s){
+            string path = "snapshot_" + to_string(s.iters) + ".bin";
+            if(!s.dumpCells(path.c_str()))
+                cerr << "Error: Cannot write " << path << endl;
+        });
+    }
 
-        double probToExcrete = 0; // Probability to excrete a current specific cell
-        static const unsigned itersExcretStart = EXCRETE_MINUTES * ITERS_PER_MINUTE; // Time to start fluoride blood excretion
-        static const unsigned reduceTimeFactor = 5 * ITERS_PER_MINUTE; // Every Y minutes the probability to excrete the fluoride increases
-        
-        // Start the excretion probability after X minutes specified using itersExcretStart iterations
-        if(iters >= itersExcretStart){
-            // Every Y minutes increase the excrete probability by reducing the time difference from the excretion start
-            if(!(iters % (reduceTimeFactor))){
-                // Excretion probability is clamped and increased using an exponential function 0.5^x to 0.0 - 1.0
-                probToExcrete = 1 - pow(0.5, (iters - itersExcretStart) / (reduceTimeFactor));
-            }
-        }
+    // Scenario interventions: the same toothpaste volume eaten again
+    for(unsigned minute : doseMinutes){
+        sim->schedule(minute * ITERS_PER_MINUTE, 0, [toothpasteVolume, minute](Simulation &s){
+            printf("-------------------------------- %3d min -------------------------------\n", minute);
+            printf("Another dose of %d ml toothpaste\n", toothpasteVolume);
+            s.dose(toothpasteVolume);
+        });
+    }
 
-        // Compare all the cells with reference rules
-        for(int y=0; y<N_WIDTH; y++){
-            for(int x=0; x<N_WIDTH; x++){
-                // Adaptation of probabilities to a current number of relevant cells
-                static const double fracToxic = 0.2; // Removal speed adjustment for fluoride excretion probability
-                static const double fracWeak = 0.02; // Removal speed adjustment for weak excretion probability
-
-                // If an excretion has already started
-                if(probToExcrete > 0){
-                    // For each toxic/weak/fluoride cell test it's removal using probToExcrete adjusted to a number of all the specific cells
-                    if(ca->curr[y][x] == CType::toxic && simlib3::Random() <= probToExcrete / (fracToxic * (cntToxic + 1)))
-                        ca->curr[y][x] = CType::oxygen;
-                    else if(ca->curr[y][x] == CType::weak && simlib3::Random() <= probToExcrete / (fracWeak * (cntWeak + 1)))
-                        ca->curr[y][x] = CType::blood;
-                    else if(ca->curr[y][x] == CType::fluoride && simlib3::Random() <= probToExcrete / (cntFluoride + 1))
-                        ca->curr[y][x] = CType::stomach;
-                }
-
-                // Apply the rules
-                ca->applyRulesToTemp(x, y);
-            }
-        }
-        // Reassign the new matrix to a current one
-        ca->curr = ca->temp;
+    FrameBuffer *buffer = new FrameBuffer();
+    thread simThread(simulate, sim, buffer, (unsigned)rate);
 
-        // Reset the counters
-        cntFluoride = cntToxic = cntOxygen = cntBlood = cntWeak = 0;
-        iters++;    
+    // Display loop renders the visible part of the latest published matrix
+    Viewer viewer;
+    bool redraw = false;
+    while(true){
+        if(buffer->acquire()){
+            viewer.update(buffer->front());
+            redraw = true;
+        }
+        if(redraw){
+            viewer.render(plane, buffer->front());
+            redraw = false;
+        }
 
         // Show the image
         imshow(window, plane);
         moveWindow(window, 240, 137);
-        // Clear the plane matrix TODO probably useless
-        plane.setTo(Scalar(0,0,0));
         
         // Wait (1000 ms / fps) seconds and continue or exit by a key press
-        // If fps == 0, use default fps 30 and enable stop on click (exit with CTRL+C)
-        if(waitKey(1000 / (fps? fps: 30)) >= 0){
-            if(!fps){
-                if(waitKey() < 0)
-                    continue;
-            }
+        // Zoom (+ -), pan (w a s d) and reset (0) keys change the view
+        // If fps == 0, use default fps 30 and pause/resume the simulation on a key press (exit with CTRL+C)
+        int key = waitKey(1000 / (fps? fps: 30));
+        if(viewer.key(key))
+            redraw = true;
+        else if(key >= 0){
+            if(!fps)
+                paused = !paused;
             else
                 break;
         }
      }
 
+    running = false;
+    simThread.join();
+
+    delete buffer;
+    delete sim;
     return(0);
 }
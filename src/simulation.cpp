@@ -0,0 +1,364 @@
+/**
+ * @file simulation.cpp
+ * @author David Kedra, xkedra00
+ * @author Petr Kolařík, xkolar79
+ * @brief Simulation engine (libcasim)
+ * 
+ * IMS Project - Cellular automata
+ * VUT FIT Brno, 2022/2023 
+ */
+
+#include <simlib.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "simulation.hpp"
+#include "grid.hpp"
+#include "kernels.hpp"
+
+// The cell states of the C interface are the CType bits
+static_assert(CASIM_CELL_NONE == CType::none && CASIM_CELL_TISSUE == CType::tissue && CASIM_CELL_TOXIC == CType::toxic
+        && CASIM_CELL_FLUORIDE == CType::fluoride && CASIM_CELL_BLOOD == CType::blood && CASIM_CELL_STOMACH == CType::stomach
+        && CASIM_CELL_OXYGEN == CType::oxygen && CASIM_CELL_WATER == CType::water && CASIM_CELL_WEAK == CType::weak,
+        "CASIM_CELL_* states must match CType");
+
+Simulation::Simulation(const casim_params_t &params, long seed):
+        params(params), iters(0), toothpasteVolume(params.toothpasteVolume),
+        amountBlood(0), amountOxygen(0), amountFluoride(0), probToExcrete(0), running(false), end(0){
+    this->ca = new CA();
+    if(params.updateMode == CASIM_UPDATE_INTENT)
+        this->ca->enableIntents();
+    this->ca->seed = seed;
+    if(params.heatmaps)
+        this->ca->enableHeatmaps();
+
+    // Init a random generator
+    simlib3::RandomSeed(seed);
+
+    // Prepare a background (tissues|stomach) a bit jagged on a border
+    // Background: Left side will be tissues and veins, Right side stomach 
+    initCellularMatrix(this->ca);
+
+    // Left side blood veins placement distribution
+    placeBloodCells(this->ca);
+
+    // Left side oxygen distribution in veins
+    placeOxygenCells(this->ca, &this->amountBlood, &this->amountOxygen);
+
+    // Right side random placement of a certain number of fluorides
+    placeFluorideCells(this->ca, &this->amountFluoride, params.weight, params.ppm, params.toothpasteVolume, this->amountBlood);
+
+    // Introducing a non-deterministic assumption of eaten amount
+    // Toothpaste volume = volume + (0.00 to 0.33) * volume
+    this->toothpasteVolume += (int)(this->toothpasteVolume * simlib3::Random() / 3);
+
+    this->count();
+
+    static const unsigned itersExcretStart = EXCRETE_MINUTES * ITERS_PER_MINUTE; // Time to start fluoride blood excretion
+    static const unsigned reduceTimeFactor = 5 * ITERS_PER_MINUTE; // Every Y minutes the probability to excrete the fluoride increases
+
+    // Start the excretion after X minutes and every Y minutes increase the excrete probability by reducing the time difference from the excretion start
+    this->schedule(itersExcretStart, reduceTimeFactor, [](Simulation &sim){
+        // Excretion probability is clamped and increased using an exponential function 0.5^x to 0.0 - 1.0
+        sim.probToExcrete = 1 - pow(0.5, (sim.iters - itersExcretStart) / (reduceTimeFactor));
+    });
+}
+
+Simulation::~Simulation(){
+    delete this->ca;
+}
+
+void Simulation::count(){
+    unsigned counts[8];
+
+    if(this->tiles.empty())
+        countCells(this->ca->curr.cells.data(), N_CELLS, counts);
+    else{
+        // The same sweep counts the tiles row by row, the totals are summed from them
+        fill(this->tiles.begin(), this->tiles.end(), 0);
+        for(unsigned y = 0; y < N_WIDTH; y++)
+            countTiles(this->ca->curr[y], N_WIDTH, &this->tiles[(size_t)(y / TILE_SIZE) * N_TILES * 8]);
+
+        for(unsigned b = 0; b < 8; b++)
+            counts[b] = 0;
+        for(size_t t = 0; t < this->tiles.size(); t += 8){
+            for(unsigned b = 0; b < 8; b++)
+                counts[b] += this->tiles[t + b];
+        }
+    }
+    this->cntFluoride = counts[__builtin_ctz(CType::fluoride)];
+    this->cntOxygen = counts[__builtin_ctz(CType::oxygen)];
+    this->cntBlood = counts[__builtin_ctz(CType::blood)];
+    this->cntToxic = counts[__builtin_ctz(CType::toxic)];
+    this->cntWeak = counts[__builtin_ctz(CType::weak)];
+
+    // The blood changes over time, so the total is a sum of these cells
+    this->cntBlood += this->cntOxygen + this->cntWeak;
+}
+
+void Simulation::excrete(int x, int y, double probToExcrete){
+    CA *ca = this->ca;
+
+    // Adaptation of probabilities to a current number of relevant cells
+    static const double fracToxic = 0.2; // Removal speed adjustment for fluoride excretion probability
+    static const double fracWeak = 0.02; // Removal speed adjustment for weak excretion probability
+
+    // For each toxic/weak/fluoride cell test it's removal using probToExcrete adjusted to a number of all the specific cells
+    // The cell's random draw 0 is used, the rules draw from 1
+    size_t idx = (size_t)y * N_WIDTH + x;
+    if(ca->curr[y][x] == CType::toxic && ca->random(idx, 0) <= probToExcrete / (fracToxic * (this->cntToxic + 1)))
+        ca->curr[y][x] = CType::oxygen;
+    else if(ca->curr[y][x] == CType::weak && ca->random(idx, 0) <= probToExcrete / (fracWeak * (this->cntWeak + 1)))
+        ca->curr[y][x] = CType::blood;
+    else if(ca->curr[y][x] == CType::fluoride && ca->random(idx, 0) <= probToExcrete / (this->cntFluoride + 1))
+        ca->curr[y][x] = CType::stomach;
+}
+
+void Simulation::update(){
+    CA *ca = this->ca;
+    // Random movement of fluoride cells
+    ca->randomMove(CType::fluoride, this->params.fullness);
+
+    // Clear temp matrix with none states
+    fillCells(ca->temp.cells.data(), CType::none, N_CELLS);
+
+    // Probability to excrete a current specific cell, set by the scheduled excretion for this iteration only
+    double probToExcrete = this->probToExcrete;
+    this->probToExcrete = 0;
+
+    // In the intentUpdate mode all the cells are excreted before any rule reads them
+    if(probToExcrete > 0 && ca->mode == UpdateMode::intentUpdate){
+        for(int y=0; y<N_WIDTH; y++){
+            for(int x=0; x<N_WIDTH; x++)
+                this->excrete(x, y, probToExcrete);
+        }
+    }
+
+    // Compare all the cells with reference rules
+    for(int y=0; y<N_WIDTH; y++){
+        for(int x=0; x<N_WIDTH; x++){
+            // In the scanUpdate mode the cells are excreted during the scan
+            if(probToExcrete > 0 && ca->mode == UpdateMode::scanUpdate)
+                this->excrete(x, y, probToExcrete);
+
+            // Apply the rules
+            ca->applyRulesToTemp(x, y);
+        }
+    }
+    // Settle the fluoride and toxic moves to the neighbouring cells
+    if(ca->mode == UpdateMode::intentUpdate)
+        ca->resolveMoves();
+
+    // Reassign the new matrix to a current one
+    copyCells(ca->curr.cells.data(), ca->temp.cells.data(), N_CELLS);
+    this->iters++;
+
+    this->count();
+}
+
+/**
+ * Calendar event of one iteration of the automata
+ */
+class StepEvent: public simlib3::Event{
+    private:
+        Simulation *sim;
+
+    public:
+        StepEvent(Simulation *sim): sim(sim){}
+
+        void Behavior(){
+            this->sim->update();
+
+            if(this->sim->onStep && !this->sim->onStep(*this->sim)){
+                simlib3::Stop();
+                return;
+            }
+            Activate(simlib3::Time + 1);
+        }
+};
+
+/**
+ * Calendar event of a scheduled action, fires before the iteration at the same time
+ */
+class ActionEvent: public simlib3::Event{
+    private:
+        Simulation *sim;
+        size_t idx;
+
+    public:
+        ActionEvent(Simulation *sim, size_t idx): sim(sim), idx(idx){
+            Priority = 1;
+        }
+
+        void Behavior(){
+            if(this->sim->fire(this->idx))
+                Activate(this->sim->actions[this->idx].time);
+        }
+};
+
+void Simulation::step(unsigned n){
+    if(!n)
+        return;
+
+    // Iterations run at the whole time units, the end is kept off them
+    this->end = (double)this->iters + n - 0.5;
+    simlib3::Init(this->iters, this->end);
+    this->running = true;
+
+    for(size_t idx = 0; idx < this->actions.size(); idx++)
+        this->activate(idx);
+    (new StepEvent(this))->Activate(this->iters);
+
+    simlib3::Run();
+    this->running = false;
+}
+
+void Simulation::schedule(unsigned iter, unsigned period, function<void(Simulation &)> action){
+    this->actions.push_back({(double)max(iter, this->iters), period, action});
+
+    // Scheduled by another action or by onStep during a step
+    if(this->running)
+        this->activate(this->actions.size() - 1);
+}
+
+void Simulation::activate(size_t idx){
+    // Actions not due in this step wait for the next one
+    if(this->actions[idx].time < this->end)
+        (new ActionEvent(this, idx))->Activate(this->actions[idx].time);
+}
+
+bool Simulation::fire(size_t idx){
+    // The action may schedule another one, which can reallocate the actions
+    function<void(Simulation &)> action = this->actions[idx].action;
+    action(*this);
+
+    scheduled_t &a = this->actions[idx];
+    if(!a.period){
+        a.time = INFINITY;
+        return false;
+    }
+    a.time += a.period;
+    // Actions not due in this step wait for the next one
+    return a.time < this->end;
+}
+
+void Simulation::enableTiles(){
+    this->tiles.assign((size_t)N_TILES * N_TILES * 8, 0);
+    this->count();
+}
+
+void Simulation::dose(unsigned volume){
+    // Fluoride cells of the new dose only, added to the eaten amount
+    unsigned added = 0;
+    placeDoseCells(this->ca, &added, this->params.weight, this->params.ppm, volume, this->amountBlood);
+    this->amountFluoride += added;
+
+    // Same non-deterministic assumption of eaten amount as for the first dose
+    this->toothpasteVolume += volume + (int)(volume * simlib3::Random() / 3);
+
+    this->count();
+}
+
+casim_stats_t Simulation::stats() const{
+    casim_stats_t s;
+
+    s.iters = this->iters;
+    s.minutes = this->iters / ITERS_PER_MINUTE;
+    s.fluoride = this->cntFluoride;
+    s.oxygen = this->cntOxygen;
+    s.blood = this->cntBlood;
+    s.toxic = this->cntToxic;
+    s.weak = this->cntWeak;
+
+    s.oxygenPerc = 100.0 * this->cntOxygen / this->cntBlood;
+    s.oxygenSaturation = min(100.0, 100.0 * this->cntOxygen / this->amountOxygen);
+    s.fluorideInBlood = (1.0 * this->cntToxic / this->amountFluoride
+        * (this->params.ppm * DENSITY_TOOTHPASTE) * (this->toothpasteVolume / 1000.0)) / this->params.weight;
+    return s;
+}
+
+bool Simulation::dumpHeatmap(HeatLayer layer, const char *path) const{
+    const vector<uint32_t> &heat = this->heatmap(layer);
+    if(heat.empty())
+        return false;
+
+    FILE *f = fopen(path, "wb");
+    if(!f)
+        return false;
+
+    uint32_t header[3] = {N_WIDTH, this->iters, layer};
+    bool ok = fwrite("CAHM", 1, 4, f) == 4
+        && fwrite(header, sizeof(uint32_t), 3, f) == 3
+        && fwrite(heat.data(), sizeof(uint32_t), heat.size(), f) == heat.size();
+    return fclose(f) == 0 && ok;
+}
+
+bool Simulation::dumpCells(const char *path) const{
+    FILE *f = fopen(path, "wb");
+    if(!f)
+        return false;
+
+    uint32_t header[2] = {N_WIDTH, this->iters};
+    bool ok = fwrite("CASN", 1, 4, f) == 4
+        && fwrite(header, sizeof(uint32_t), 2, f) == 2
+        && fwrite(this->ca->curr.cells.data(), sizeof(CType), this->ca->curr.cells.size(), f) == this->ca->curr.cells.size();
+    return fclose(f) == 0 && ok;
+}
+
+/**
+ * C handle is the simulation object itself
+ */
+struct casim: public Simulation{
+    casim(const casim_params_t &params, long seed): Simulation(params, seed){}
+};
+
+casim_t *casim_create(const casim_params_t *params, long seed){
+    return new casim(*params, seed);
+}
+
+void casim_destroy(casim_t *sim){
+    delete sim;
+}
+
+void casim_step(casim_t *sim, unsigned n){
+    sim->step(n);
+}
+
+void casim_stats(const casim_t *sim, casim_stats_t *stats){
+    *stats = sim->stats();
+}
+
+const uint8_t *casim_cells(const casim_t *sim, unsigned *width){
+    if(width)
+        *width = N_WIDTH;
+    return reinterpret_cast<const uint8_t *>(sim->cells().cells.data());
+}
+
+const uint32_t *casim_heatmap(const casim_t *sim, unsigned layer){
+    if(layer >= N_HEAT_LAYERS || sim->heatmap((HeatLayer)layer).empty())
+        return NULL;
+    return sim->heatmap((HeatLayer)layer).data();
+}
+
+int casim_dump_heatmap(const casim_t *sim, unsigned layer, const char *path){
+    if(layer >= N_HEAT_LAYERS)
+        return -1;
+    return sim->dumpHeatmap((HeatLayer)layer, path)? 0: -1;
+}
+
+void casim_schedule(casim_t *sim, unsigned iter, unsigned period, void (*action)(casim_t *sim, void *data), void *data){
+    sim->schedule(iter, period, [sim, action, data](Simulation &){
+        action(sim, data);
+    });
+}
+
+void casim_schedule_dose(casim_t *sim, unsigned iter, unsigned volume){
+    sim->schedule(iter, 0, [volume](Simulation &s){
+        s.dose(volume);
+    });
+}
+
+int casim_dump_cells(const casim_t *sim, const char *path){
+    return sim->dumpCells(path)? 0: -1;
+}
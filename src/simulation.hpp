@@ -0,0 +1,176 @@
+/**
+ * @file simulation.hpp
+ * @author David Kedra, xkedra00
+ * @author Petr Kolařík, xkolar79
+ * @brief Declarations of the simulation engine (C++ interface of libcasim)
+ * 
+ * IMS Project - Cellular automata
+ * VUT FIT Brno, 2022/2023 
+ */
+
+#pragma once
+
+#include <functional>
+
+#include "casim.h"
+#include "cellular_automata.hpp"
+
+#define EXCRETE_MINUTES 120         ///< Average time until the fluoride starts excretion to livers
+#define ITERS_PER_MINUTE 12         ///< How many iterations is approximately 1 minute
+#define N_TILES ((N_WIDTH + TILE_SIZE - 1) / TILE_SIZE) ///< Number of tiles in each row
+
+class Simulation;
+
+/**
+ * Action scheduled in the simulation calendar
+ */
+typedef struct{
+    double time;                            ///< Next activation (in iterations)
+    unsigned period;                        ///< Iterations between the activations (0 for a single one)
+    function<void(Simulation &)> action;    ///< Action to be done
+}scheduled_t;
+
+/**
+ * Simulation of the fluoride spreading from the stomach to the blood
+ */
+class Simulation{
+    public:
+        CA *ca;                     ///< Cellular automata object with plane states
+        casim_params_t params;      ///< Parameters of the person and the toothpaste
+
+        unsigned iters;             ///< Counter of iterations
+        unsigned toothpasteVolume;  ///< Toothpaste volume with the non-deterministic eaten amount included
+
+        unsigned amountBlood;       ///< Total amount of blood with oxygen at the start
+        unsigned amountOxygen;      ///< Amount of oxygen cells at the start
+        unsigned amountFluoride;    ///< Amount of fluoride cells at the start
+
+        unsigned cntFluoride;       ///< Counter of fluoride cells
+        unsigned cntOxygen;         ///< Counter of oxygen cells
+        unsigned cntBlood;          ///< Counter of blood cells (blood + oxygen + weak)
+        unsigned cntToxic;          ///< Counter of toxic cells
+        unsigned cntWeak;           ///< Counter of weak cells
+
+        vector<uint32_t> tiles;     ///< Cell counts of each tile by the state bit: tiles[(ty * N_TILES + tx) * 8 + bit] (empty until enabled)
+
+        double probToExcrete;       ///< Probability to excrete a toxic/weak/fluoride cell in the next iteration
+
+        /**
+         * Called after each iteration of a step; returning false stops the step early
+         */
+        function<bool(Simulation &)> onStep;
+
+        /**
+         * Seed the random generator and place the initial cells
+         * @param params Parameters of the person and the toothpaste
+         * @param seed Seed of the SIMLIB random generator
+         */
+        Simulation(const casim_params_t &params, long seed);
+        ~Simulation();
+
+        // Owns the automata, so it cannot be copied
+        Simulation(const Simulation &) = delete;
+        Simulation &operator=(const Simulation &) = delete;
+
+        /**
+         * Run n iterations of the automata (fluoride movement, excretion and rules) driven by the SIMLIB calendar.
+         * One iteration is one unit of the simulated time. The scheduled actions of an iteration fire before it.
+         * The calendar is global, so only one simulation can be stepped at a time.
+         * @param n Number of iterations
+         */
+        void step(unsigned n = 1);
+
+        /**
+         * Schedule an action in the simulation calendar
+         * @param iter Iteration of the first activation (not before the current one)
+         * @param period Iterations between the activations (0 for a single one)
+         * @param action Action to be done
+         */
+        void schedule(unsigned iter, unsigned period, function<void(Simulation &)> action);
+
+        /**
+         * Start counting the cells of each TILE_SIZE x TILE_SIZE tile in the counting sweep
+         */
+        void enableTiles();
+
+        /**
+         * Eat another dose of the toothpaste, placing more fluoride cells into the stomach
+         * @param volume Toothpaste volume in ml
+         */
+        void dose(unsigned volume);
+
+        /**
+         * Get the counters and the derived metrics of the current matrix
+         * @return casim_stats_t Statistics
+         */
+        casim_stats_t stats() const;
+
+        /**
+         * Get a read-only view of the current cell matrix
+         * @return const Grid& Current matrix
+         */
+        const Grid &cells() const { return ca->curr; }
+
+        /**
+         * Get a read-only view of a heatmap layer
+         * @param layer Heatmap layer
+         * @return const vector<uint32_t>& Row-major counters (empty if the heatmaps are disabled)
+         */
+        const vector<uint32_t> &heatmap(HeatLayer layer) const { return ca->heat[layer]; }
+
+        /**
+         * Dump a heatmap layer into a binary file (format described at casim_dump_heatmap)
+         * @param layer Heatmap layer
+         * @param path Output file path
+         * @return bool True on success
+         */
+        bool dumpHeatmap(HeatLayer layer, const char *path) const;
+
+        /**
+         * Dump the current cell matrix into a binary snapshot file for an analysis, the run cannot be resumed from it.
+         * The file starts with the "CASN" magic followed by the uint32_t width and iteration,
+         * then width x width CType bytes in a row-major order
+         * @param path Output file path
+         * @return bool True on success
+         */
+        bool dumpCells(const char *path) const;
+
+    private:
+        friend class StepEvent;
+        friend class ActionEvent;
+
+        vector<scheduled_t> actions;    ///< Calendar actions
+        bool running;                   ///< The calendar of this simulation is being run
+        double end;                     ///< End time of the running step
+
+        /**
+         * One iteration of the automata
+         */
+        void update();
+
+        /**
+         * Test the removal of a toxic/weak/fluoride cell from the current matrix
+         * @param x X matrix coordinate
+         * @param y Y matrix coordinate
+         * @param probToExcrete Probability to excrete in this iteration
+         */
+        void excrete(int x, int y, double probToExcrete);
+
+        /**
+         * Do a scheduled action and plan its next activation
+         * @param idx Index of the action
+         * @return bool True if the action is activated again in the running step
+         */
+        bool fire(size_t idx);
+
+        /**
+         * Put a scheduled action into the SIMLIB calendar
+         * @param idx Index of the action
+         */
+        void activate(size_t idx);
+
+        /**
+         * Recount the cells of the current matrix
+         */
+        void count();
+};